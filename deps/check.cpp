@@ -0,0 +1,530 @@
+// randomized differential test and benchmark of the native kernels
+//
+//   usage: check [n_trials [baseline [tolerance]]]
+//
+// Every kernel is compared against a scalar DP over n_trials random inputs
+// (default: 2000), then its throughput is measured on a fixed workload. The
+// output is a table of
+//
+//   name  checked  failed  gcups  speedup
+//
+// where gcups is the median throughput in giga cell updates per second and
+// speedup is the median ratio to the scalar DP timed right after each window.
+// A previous output can be passed as the baseline: a kernel whose speedup is
+// below tolerance (default: 0.8) times its baseline speedup fails the run as
+// well as a wrong answer.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include "simdalign.h"
+
+typedef std::vector<uint8_t> bytes_t;
+
+static std::mt19937_64 rng(0x5eed);
+
+static size_t randint(size_t lo, size_t hi)
+{
+    return std::uniform_int_distribution<size_t>(lo, hi)(rng);
+}
+
+
+// scalar reference implementations
+
+// global alignment score with affine gaps (Gotoh); submat is indexed by (ref, seq)
+static int64_t gotoh_score(const bytes_t& seq,
+                           const bytes_t& ref,
+                           const std::vector<int64_t>& submat,
+                           const int size,
+                           const int64_t gap_open,
+                           const int64_t gap_extend)
+{
+    const int64_t ninf = std::numeric_limits<int32_t>::min();
+    const size_t m = seq.size(), n = ref.size();
+    std::vector<int64_t> H(m + 1), F(m + 1, ninf);
+    for (size_t i = 0; i <= m; i++)
+        H[i] = i == 0 ? 0 : -(gap_open + gap_extend * i);
+    for (size_t j = 1; j <= n; j++) {
+        int64_t H_diag = H[0], E = ninf;
+        H[0] = -(gap_open + gap_extend * j);
+        for (size_t i = 1; i <= m; i++) {
+            E = std::max(H[i-1] - gap_open - gap_extend, E - gap_extend);
+            F[i] = std::max(H[i] - gap_open - gap_extend, F[i] - gap_extend);
+            int64_t h = std::max(H_diag + submat[ref[j-1] * size + seq[i-1]], std::max(E, F[i]));
+            H_diag = H[i];
+            H[i] = h;
+        }
+    }
+    return H[m];
+}
+
+// unit-cost edit distance (global or semi-global)
+static int64_t edit_distance(const bytes_t& seq, const bytes_t& ref, const int mode)
+{
+    const size_t m = seq.size(), n = ref.size();
+    std::vector<int64_t> D(m + 1);
+    for (size_t i = 0; i <= m; i++)
+        D[i] = i;
+    int64_t best = D[m];
+    for (size_t j = 1; j <= n; j++) {
+        int64_t D_diag = D[0];
+        D[0] = mode == EDIT_GLOBAL ? j : 0;
+        for (size_t i = 1; i <= m; i++) {
+            int64_t d = std::min(D_diag + (seq[i-1] != ref[j-1]), std::min(D[i-1], D[i]) + 1);
+            D_diag = D[i];
+            D[i] = d;
+        }
+        best = std::min(best, D[m]);
+    }
+    return mode == EDIT_GLOBAL ? D[m] : best;
+}
+
+static bytes_t revcomp(const bytes_t& seq)
+{
+    bytes_t rc(seq.rbegin(), seq.rend());
+    for (uint8_t& x : rc)
+        x ^= 0b11;
+    return rc;
+}
+
+
+// random inputs
+
+struct input_t
+{
+    // alphabet size (4 if sequences are nucleotides)
+    int size;
+    // whether seq is packed (both strands can be aligned)
+    bool packed;
+    bytes_t seq;
+    std::vector<bytes_t> refs;
+    // the same sequences in various layouts; data are kept in storage
+    std::deque<bytes_t> storage;
+    std::vector<seq_t> seq_ts;
+    std::vector<seq_t> ref_ts;
+};
+
+// make a view of seq in a random layout (packed layouts require 2-bit characters)
+static seq_t make_seq(const bytes_t& seq, const bool packed, std::deque<bytes_t>& storage)
+{
+    const size_t len = seq.size();
+    const size_t pad = randint(0, 7);
+    const bool reversed = randint(0, 1);
+    const bool complemented = packed && randint(0, 1);
+    bytes_t data(pad + len);
+    for (size_t i = 0; i < len; i++) {
+        uint8_t x = seq[reversed ? len - 1 - i : i];
+        data[pad + i] = complemented ? x ^ 0b11 : x;
+    }
+    const size_t offset = len == 0 ? 0 : reversed ? pad + len - 1 : pad;
+    if (packed) {
+        bytes_t packed_data((data.size() + 3) / 4, 0);
+        for (size_t i = 0; i < data.size(); i++)
+            packed_data[i / 4] |= data[i] << (i % 4 * 2);
+        data.swap(packed_data);
+    }
+    storage.push_back(data);
+    return seq_t(storage.back().data(), len, offset, reversed, packed, complemented);
+}
+
+static void make_input(input_t& input, const size_t maxlen)
+{
+    const bool dna = randint(0, 3) > 0;
+    input.size = dna ? 4 : randint(5, 24);
+    input.packed = dna && randint(0, 3) > 0;
+    input.seq.resize(randint(0, 9) == 0 ? 0 : randint(1, maxlen));
+    for (uint8_t& x : input.seq)
+        x = randint(0, input.size - 1);
+
+    // lane refill is exercised by many short or empty references
+    const size_t n_refs = randint(0, 4) == 0 ? randint(0, 3) : randint(1, 80);
+    const size_t p_empty = randint(0, 3) == 0 ? randint(0, 100) : 0;
+    input.refs.resize(n_refs);
+    for (bytes_t& ref : input.refs) {
+        ref.resize(randint(1, 100) <= p_empty ? 0 : randint(1, maxlen));
+        for (uint8_t& x : ref)
+            x = randint(0, input.size - 1);
+    }
+
+    input.storage.clear();
+    input.seq_ts.clear();
+    input.ref_ts.clear();
+    input.seq_ts.push_back(make_seq(input.seq, input.packed, input.storage));
+    for (const bytes_t& ref : input.refs)
+        input.ref_ts.push_back(make_seq(ref, dna && randint(0, 1), input.storage));
+}
+
+
+// kernels
+
+template<typename score_t>
+using kernel_t = int (*)(buffer_t*,
+                         const submat_t<score_t>,
+                         const score_t,
+                         const score_t,
+                         const seq_t,
+                         const seq_t*,
+                         const int,
+                         alignment_t**);
+
+typedef int (*edit_kernel_t)(buffer_t*, const int, const seq_t, const seq_t*, const int, alignment_t**);
+
+struct result_t
+{
+    size_t checked;
+    size_t failed;
+    double gcups;
+    double speedup;
+};
+
+static std::vector<std::string> names;
+static std::map<std::string,result_t> results;
+
+static result_t& result(const std::string& name)
+{
+    if (results.find(name) == results.end()) {
+        names.push_back(name);
+        results[name] = result_t{0, 0, 0.0, 0.0};
+    }
+    return results[name];
+}
+
+static void report(const std::string& name, const size_t i, const int64_t expected, const int64_t got)
+{
+    result_t& r = result(name);
+    if (r.failed++ < 5)
+        fprintf(stderr, "%s: ref %zu: expected %lld, got %lld\n", name.c_str(), i, (long long)expected, (long long)got);
+}
+
+template<typename score_t>
+static void check_score(const std::string& name,
+                        kernel_t<score_t> kernel,
+                        const bool both,
+                        const input_t& input,
+                        const std::vector<int64_t>& submat,
+                        const int64_t gap_open,
+                        const int64_t gap_extend,
+                        buffer_t* buffer)
+{
+    if (both && !input.packed)
+        return;
+    std::vector<score_t> submat_(submat.begin(), submat.end());
+    std::vector<alignment_t> alns(input.refs.size(), alignment_t(0xdead));
+    std::vector<alignment_t*> ptrs;
+    for (alignment_t& aln : alns)
+        ptrs.push_back(&aln);
+    int ret = kernel(buffer, submat_t<score_t>(submat_.data(), input.size), gap_open, gap_extend,
+                     input.seq_ts[0], input.ref_ts.data(), input.refs.size(), ptrs.data());
+    result(name).checked++;
+    if (ret != 0) {
+        report(name, 0, 0, ret);
+        return;
+    }
+    const bytes_t rc = both ? revcomp(input.seq) : bytes_t();
+    for (size_t i = 0; i < input.refs.size(); i++) {
+        int64_t fwd = gotoh_score(input.seq, input.refs[i], submat, input.size, gap_open, gap_extend);
+        int64_t rev = both ? gotoh_score(rc, input.refs[i], submat, input.size, gap_open, gap_extend) : fwd;
+        int64_t expected = std::max(fwd, rev);
+        if (alns[i].score != expected)
+            report(name, i, expected, alns[i].score);
+        else if (both && alns[i].strand != (rev > fwd ? 1 : 0))
+            report(name + " (strand)", i, rev > fwd, alns[i].strand);
+    }
+}
+
+static void check_edit(const std::string& name,
+                       edit_kernel_t kernel,
+                       const int mode,
+                       const input_t& input,
+                       buffer_t* buffer)
+{
+    std::vector<alignment_t> alns(input.refs.size(), alignment_t(0xdead));
+    std::vector<alignment_t*> ptrs;
+    for (alignment_t& aln : alns)
+        ptrs.push_back(&aln);
+    int ret = kernel(buffer, mode, input.seq_ts[0], input.ref_ts.data(), input.refs.size(), ptrs.data());
+    result(name).checked++;
+    if (ret != 0) {
+        report(name, 0, 0, ret);
+        return;
+    }
+    for (size_t i = 0; i < input.refs.size(); i++) {
+        int64_t expected = edit_distance(input.seq, input.refs[i], mode);
+        if (alns[i].score != expected)
+            report(name, i, expected, alns[i].score);
+    }
+}
+
+// sharded search must agree with ranking all scores at once
+static void check_search(const std::string& name,
+                         const input_t& input,
+                         const std::vector<int64_t>& submat,
+                         const int64_t gap_open,
+                         const int64_t gap_extend)
+{
+    std::vector<hit_t> expected;
+    for (size_t i = 0; i < input.refs.size(); i++)
+        expected.push_back(hit_t{i, gotoh_score(input.seq, input.refs[i], submat, input.size, gap_open, gap_extend)});
+    const int64_t threshold = expected.empty() || randint(0, 1) ? std::numeric_limits<int64_t>::min() : expected[0].score;
+    expected.erase(std::remove_if(expected.begin(), expected.end(), [=](const hit_t& hit) { return hit.score < threshold; }), expected.end());
+    std::stable_sort(expected.begin(), expected.end(), [](const hit_t& x, const hit_t& y) { return x.score > y.score; });
+    const size_t top_k = randint(0, 10);
+    if (top_k > 0 && expected.size() > top_k)
+        expected.resize(top_k);
+
+    std::vector<int32_t> submat_(submat.begin(), submat.end());
+    search_t* search = make_search(randint(1, 20), top_k, threshold);
+    result(name).checked++;
+    if (search_shard_i32x8(search, submat_t<int32_t>(submat_.data(), input.size), gap_open, gap_extend,
+                           input.seq_ts[0], input.ref_ts.data(), input.refs.size())) {
+        report(name, 0, 0, 1);
+        free_search(search);
+        return;
+    }
+    std::vector<hit_t> hits(search_n_hits(search));
+    search_hits(search, hits.data());
+    free_search(search);
+    if (hits.size() != expected.size()) {
+        report(name + " (n_hits)", 0, expected.size(), hits.size());
+        return;
+    }
+    for (size_t i = 0; i < hits.size(); i++)
+        if (hits[i].ref_id != expected[i].ref_id || hits[i].score != expected[i].score)
+            report(name, expected[i].ref_id, expected[i].score, hits[i].score);
+}
+
+
+// throughput
+
+// GCUPS of run over a timing window of at least window seconds
+static const double window = 0.1;
+
+template<typename F>
+static double time_window(F run, const double cells)
+{
+    typedef std::chrono::steady_clock clock;
+    size_t n = 0;
+    const clock::time_point start = clock::now();
+    double elapsed;
+    do {
+        run();
+        n++;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    } while (elapsed < window);
+    return cells * n / elapsed * 1e-9;
+}
+
+static double median(std::vector<double> xs)
+{
+    std::nth_element(xs.begin(), xs.begin() + xs.size() / 2, xs.end());
+    return xs[xs.size() / 2];
+}
+
+// Throughput of run is timed in n_windows windows after a warm-up window, each
+// followed by a window of the scalar Gotoh DP on the same query. The speed of
+// a shared machine drifts by tens of percent over seconds, which moves both
+// windows of a pair alike; so the speedup over the scalar DP is what the
+// baseline is compared on, while GCUPS is reported for reading.
+static const int n_windows = 9;
+static volatile int64_t sink;
+
+template<typename F>
+static void measure(result_t& r, F run, const double cells, const input_t& input)
+{
+    std::vector<int64_t> submat(16, -3);
+    for (int i = 0; i < 4; i++)
+        submat[i * 4 + i] = 2;
+    const size_t n_refs = 10;
+    double scalar_cells = 0;
+    for (size_t j = 0; j < n_refs; j++)
+        scalar_cells += (double)input.seq.size() * input.refs[j].size();
+    auto scalar = [&]() {
+        for (size_t j = 0; j < n_refs; j++)
+            sink = gotoh_score(input.seq, input.refs[j], submat, 4, 3, 1);
+    };
+    std::vector<double> gcups, speedups;
+    for (int w = 0; w <= n_windows; w++) {
+        const double x = time_window(run, cells);
+        const double y = time_window(scalar, scalar_cells);
+        if (w > 0) {
+            gcups.push_back(x);
+            speedups.push_back(x / y);
+        }
+    }
+    r.gcups = median(gcups);
+    r.speedup = median(speedups);
+}
+
+template<typename score_t>
+static void bench_score(const std::string& name, kernel_t<score_t> kernel, const bool both, const input_t& input, buffer_t* buffer)
+{
+    std::vector<score_t> submat(16, -3);
+    for (int i = 0; i < 4; i++)
+        submat[i * 4 + i] = 2;
+    std::vector<alignment_t> alns(input.refs.size(), alignment_t(0));
+    std::vector<alignment_t*> ptrs;
+    for (alignment_t& aln : alns)
+        ptrs.push_back(&aln);
+    double cells = 0;
+    for (const bytes_t& ref : input.refs)
+        cells += (double)input.seq.size() * ref.size() * (both ? 2 : 1);
+    measure(result(name), [&]() {
+        kernel(buffer, submat_t<score_t>(submat.data(), 4), 3, 1, input.seq_ts[0], input.ref_ts.data(), input.refs.size(), ptrs.data());
+    }, cells, input);
+}
+
+static void bench_edit(const std::string& name, edit_kernel_t kernel, const int mode, const input_t& input, buffer_t* buffer)
+{
+    std::vector<alignment_t> alns(input.refs.size(), alignment_t(0));
+    std::vector<alignment_t*> ptrs;
+    for (alignment_t& aln : alns)
+        ptrs.push_back(&aln);
+    double cells = 0;
+    for (const bytes_t& ref : input.refs)
+        cells += (double)input.seq.size() * ref.size();
+    measure(result(name), [&]() {
+        kernel(buffer, mode, input.seq_ts[0], input.ref_ts.data(), input.refs.size(), ptrs.data());
+    }, cells, input);
+}
+
+static void bench_search(const std::string& name, const input_t& input)
+{
+    std::vector<int32_t> submat(16, -3);
+    for (int i = 0; i < 4; i++)
+        submat[i * 4 + i] = 2;
+    double cells = 0;
+    for (const bytes_t& ref : input.refs)
+        cells += (double)input.seq.size() * ref.size();
+    measure(result(name), [&]() {
+        search_t* search = make_search(500, 100, std::numeric_limits<int64_t>::min());
+        search_shard_i32x8(search, submat_t<int32_t>(submat.data(), 4), 3, 1, input.seq_ts[0], input.ref_ts.data(), input.refs.size());
+        free_search(search);
+    }, cells, input);
+}
+
+
+#define FOR_EACH_SCORE_KERNEL(f) \
+    f(int8_t,  i8x16,  false, true)  \
+    f(int16_t, i16x8,  false, false) \
+    f(int32_t, i32x4,  false, false) \
+    f(int8_t,  i8x32,  false, true)  \
+    f(int16_t, i16x16, false, false) \
+    f(int32_t, i32x8,  false, false) \
+    f(int8_t,  both_i8x16,  true, true)  \
+    f(int16_t, both_i16x8,  true, false) \
+    f(int32_t, both_i32x4,  true, false) \
+    f(int8_t,  both_i8x32,  true, true)  \
+    f(int16_t, both_i16x16, true, false) \
+    f(int32_t, both_i32x8,  true, false)
+
+#define FOR_EACH_EDIT_KERNEL(f) \
+    f(i64x2, EDIT_GLOBAL,     "global")     \
+    f(i64x4, EDIT_GLOBAL,     "global")     \
+    f(i64x2, EDIT_SEMIGLOBAL, "semiglobal") \
+    f(i64x4, EDIT_SEMIGLOBAL, "semiglobal")
+
+int main(int argc, char** argv)
+{
+    const size_t n_trials = argc > 1 ? atol(argv[1]) : 2000;
+    const char* baseline = argc > 2 ? argv[2] : NULL;
+    const double tolerance = argc > 3 ? atof(argv[3]) : 0.8;
+    buffer_t* buffer = make_buffer();
+    input_t input;
+
+    // correctness
+    for (size_t trial = 0; trial < n_trials; trial++) {
+        // 8-bit scores must not overflow: |H| <= 2 * gap_open + gap_extend * (m + n) + 3
+        const bool short_ = trial % 2 == 0;
+        make_input(input, short_ ? 20 : 150);
+        const int64_t gap_open = randint(0, short_ ? 3 : 10);
+        const int64_t gap_extend = randint(1, short_ ? 1 : 3);
+        std::vector<int64_t> submat(input.size * input.size);
+        for (int64_t& s : submat)
+            s = (int64_t)randint(0, short_ ? 5 : 10) - (short_ ? 3 : 5);
+
+#define CHECK_SCORE(score_t, suffix, both, small) \
+        if (short_ || !small) \
+            check_score<score_t>("paralign_score_" #suffix, paralign_score_##suffix, both, input, submat, gap_open, gap_extend, buffer);
+        FOR_EACH_SCORE_KERNEL(CHECK_SCORE)
+#undef CHECK_SCORE
+
+#define CHECK_EDIT(suffix, mode, modename) \
+        check_edit("paredit_distance_" #suffix " (" modename ")", paredit_distance_##suffix, mode, input, buffer);
+        FOR_EACH_EDIT_KERNEL(CHECK_EDIT)
+#undef CHECK_EDIT
+
+        check_search("search_shard_i32x8", input, submat, gap_open, gap_extend);
+    }
+
+    // throughput; the workload does not depend on n_trials
+    rng.seed(0xbe9c4);
+    std::vector<bytes_t> refs(2000);
+    input.size = 4;
+    input.packed = true;
+    input.seq.resize(200);
+    for (uint8_t& x : input.seq)
+        x = randint(0, 3);
+    input.refs.clear();
+    input.storage.clear();
+    input.seq_ts.clear();
+    input.ref_ts.clear();
+    input.seq_ts.push_back(make_seq(input.seq, true, input.storage));
+    for (bytes_t& ref : refs) {
+        ref.resize(randint(100, 400));
+        for (uint8_t& x : ref)
+            x = randint(0, 3);
+        input.refs.push_back(ref);
+        input.ref_ts.push_back(seq_t(ref));
+    }
+
+#define BENCH_SCORE(score_t, suffix, both, small) \
+    bench_score<score_t>("paralign_score_" #suffix, paralign_score_##suffix, both, input, buffer);
+    FOR_EACH_SCORE_KERNEL(BENCH_SCORE)
+#undef BENCH_SCORE
+
+#define BENCH_EDIT(suffix, mode, modename) \
+    bench_edit("paredit_distance_" #suffix " (" modename ")", paredit_distance_##suffix, mode, input, buffer);
+    FOR_EACH_EDIT_KERNEL(BENCH_EDIT)
+#undef BENCH_EDIT
+
+    bench_search("search_shard_i32x8", input);
+
+    free_buffer(buffer);
+
+    // report
+    int status = 0;
+    printf("%-40s %8s %8s %8s %8s\n", "# name", "checked", "failed", "gcups", "speedup");
+    for (const std::string& name : names) {
+        const result_t& r = results[name];
+        printf("%-40s %8zu %8zu %8.3f %8.2f\n", ("'" + name + "'").c_str(), r.checked, r.failed, r.gcups, r.speedup);
+        if (r.failed > 0)
+            status = 1;
+    }
+
+    // compare throughput with the baseline
+    if (baseline != NULL) {
+        FILE* file = fopen(baseline, "r");
+        if (file == NULL) {
+            fprintf(stderr, "failed to open %s\n", baseline);
+            return 1;
+        }
+        char line[256], name[128];
+        size_t checked, failed;
+        double gcups, speedup;
+        while (fgets(line, sizeof(line), file) != NULL) {
+            if (sscanf(line, " '%127[^']' %zu %zu %lf %lf", name, &checked, &failed, &gcups, &speedup) != 5)
+                continue;
+            if (results.count(name) && results[name].speedup < speedup * tolerance) {
+                fprintf(stderr, "%s: %.2fx the scalar DP is slower than the baseline %.2fx\n", name, results[name].speedup, speedup);
+                status = 1;
+            }
+        }
+        fclose(file);
+    }
+
+    return status;
+}
@@ -4,39 +4,12 @@
 #include <array>
 #include "simdalign.h"
 
-struct slot_t
-{
-    int id;
-    size_t pos;
-
-    slot_t() {}
-    slot_t(int id, size_t pos) : id(id), pos(pos) {}
-
-    inline bool operator==(const slot_t &other) const {
-        return id == other.id;
-    }
-    inline bool operator!=(const slot_t &other) const {
-        return id != other.id;
-    }
-};
-
-const slot_t empty_slot = slot_t(-1, 0);
-
 template<typename score_t>
 static inline score_t affine_gap_score(int k, score_t gap_open, score_t gap_extend)
 {
     return k > 0 ? -(gap_open + gap_extend * k) : 0;
 }
 
-template<size_t n>
-static bool is_vacant(const std::array<slot_t,n> slots)
-{
-    for (const slot_t& slot : slots)
-        if (slot != empty_slot)
-            return false;
-    return true;
-}
-
 template<typename vec_t,typename score_t,size_t n>
 static void fill_profile(const seq_t* refs,
                          const std::array<slot_t,n>& slots,
@@ -103,36 +76,59 @@ static void loop(const uint8_t* useq,
 }
 
 
+// record the best score among the strands of lane k
 template<typename vec_t,typename score_t>
-int paralign_score(buffer_t* buffer,
-                   const submat_t<score_t> submat,
-                   const score_t gap_open,
-                   const score_t gap_extend,
-                   const seq_t seq,
-                   const seq_t* refs,
-                   const int n_refs,
-                   alignment_t** alignments)
+static void set_score(const vec_t* cols,
+                      const size_t seqlen,
+                      const int n_strands,
+                      const int k,
+                      alignment_t* alignment)
+{
+    for (int s = 0; s < n_strands; s++) {
+        const vec_t* colH = cols + (seqlen + 1) * (2 * s + 1);
+        score_t score = simd_extract<score_t>(colH[seqlen], k);
+        if (s == 0 || score > alignment->score) {
+            alignment->score = score;
+            alignment->strand = s;
+        }
+    }
+}
+
+// align each of seqs (strands of the same length) against refs in one pass
+template<typename vec_t,typename score_t>
+static int paralign_score_strands(buffer_t* buffer,
+                                  const submat_t<score_t> submat,
+                                  const score_t gap_open,
+                                  const score_t gap_extend,
+                                  const seq_t* seqs,
+                                  const int n_strands,
+                                  const seq_t* refs,
+                                  const int n_refs,
+                                  alignment_t** alignments)
 {
     if (n_refs == 0)
         return 0;
     else if (n_refs < 0)
         return 1;
 
+    const size_t seqlen = seqs[0].len;
+
     // allocate working space
-    if (expand_buffer(buffer, sizeof(vec_t) * (seq.len + 1) * 2 +
+    if (expand_buffer(buffer, sizeof(vec_t) * (seqlen + 1) * 2 * n_strands +
                               sizeof(vec_t) * submat.size +
-                              sizeof(uint8_t) * seq.len)) {
+                              sizeof(uint8_t) * seqlen * n_strands)) {
         return 1;
     }
+    // colE and colH of strand s start at cols + (seqlen + 1) * 2 * s
     // NOTE: colE[0] is not used
-    vec_t* colE = (vec_t*)buffer->data;
-    vec_t* colH = colE + seq.len + 1;
-    vec_t* prof = colH + seq.len + 1;
-    uint8_t* useq = reinterpret_cast<uint8_t*>(prof + submat.size);
+    vec_t* cols = (vec_t*)buffer->data;
+    vec_t* prof = cols + (seqlen + 1) * 2 * n_strands;
+    uint8_t* useqs = reinterpret_cast<uint8_t*>(prof + submat.size);
 
-    // unpack sequence
-    for (size_t i = 0; i < seq.len; i++)
-        useq[i] = seq[i];
+    // unpack sequences (complemented on the fly if requested)
+    for (int s = 0; s < n_strands; s++)
+        for (size_t i = 0; i < seqlen; i++)
+            useqs[seqlen * s + i] = seqs[s][i];
 
     // initialize slots which hold the reference sequences
     const int n_max_par = sizeof(vec_t) / sizeof(score_t);
@@ -151,22 +147,26 @@ int paralign_score(buffer_t* buffer,
                 if (slot.pos < refs[slot.id].len)
                     continue;
                 else
-                    (*alignments[slot.id]).score = simd_extract<score_t>(colH[seq.len], k);
+                    set_score<vec_t,score_t>(cols, seqlen, n_strands, k, alignments[slot.id]);
             }
 
             // find the next non-empty sequences if any
             bool found = false;
             while (next_ref < n_refs && !found) {
                 // reset E and H
-                colH[0] = simd_insert<score_t>(colH[0], 0, k);
-                for (int i = 1; i <= seq.len; i++) {
-                    score_t h = affine_gap_score(i, gap_open, gap_extend);
-                    colH[i] = simd_insert(colH[i], h, k);
-                    colE[i] = simd_insert(colE[i], static_cast<score_t>(h - (gap_open + gap_extend)), k);
+                for (int s = 0; s < n_strands; s++) {
+                    vec_t* colE = cols + (seqlen + 1) * 2 * s;
+                    vec_t* colH = colE + seqlen + 1;
+                    colH[0] = simd_insert<score_t>(colH[0], 0, k);
+                    for (int i = 1; i <= seqlen; i++) {
+                        score_t h = affine_gap_score(i, gap_open, gap_extend);
+                        colH[i] = simd_insert(colH[i], h, k);
+                        colE[i] = simd_insert(colE[i], static_cast<score_t>(h - (gap_open + gap_extend)), k);
+                    }
                 }
                 seq_t ref = refs[next_ref];
                 if (ref.len == 0) {
-                    (*alignments[next_ref++]).score = simd_extract<score_t>(colH[seq.len], k);
+                    set_score<vec_t,score_t>(cols, seqlen, n_strands, k, alignments[next_ref++]);
                 }
                 else {
                     slot.id = next_ref++;
@@ -183,17 +183,51 @@ int paralign_score(buffer_t* buffer,
         if (is_vacant(slots))
             break;
 
-        // fill the temporary profile
+        // fill the temporary profile (shared by all strands)
         fill_profile(refs, slots, submat, prof);
 
         // inner loop along seq
         // TODO: detect saturation
-        loop(useq, seq.len, prof, slots, gap_open, gap_extend, colE, colH);
+        for (int s = 0; s < n_strands; s++) {
+            vec_t* colE = cols + (seqlen + 1) * 2 * s;
+            vec_t* colH = colE + seqlen + 1;
+            loop(useqs + seqlen * s, seqlen, prof, slots, gap_open, gap_extend, colE, colH);
+        }
     }
 
     return 0;
 }
 
+template<typename vec_t,typename score_t>
+int paralign_score(buffer_t* buffer,
+                   const submat_t<score_t> submat,
+                   const score_t gap_open,
+                   const score_t gap_extend,
+                   const seq_t seq,
+                   const seq_t* refs,
+                   const int n_refs,
+                   alignment_t** alignments)
+{
+    return paralign_score_strands<vec_t>(buffer, submat, gap_open, gap_extend, &seq, 1, refs, n_refs, alignments);
+}
+
+template<typename vec_t,typename score_t>
+int paralign_score_both(buffer_t* buffer,
+                        const submat_t<score_t> submat,
+                        const score_t gap_open,
+                        const score_t gap_extend,
+                        const seq_t seq,
+                        const seq_t* refs,
+                        const int n_refs,
+                        alignment_t** alignments)
+{
+    // complement is defined only for 2-bit nucleotides
+    if (!seq.packed)
+        return 1;
+    const seq_t seqs[2] = {seq, seq.revcomp()};
+    return paralign_score_strands<vec_t>(buffer, submat, gap_open, gap_extend, seqs, 2, refs, n_refs, alignments);
+}
+
 
 // 128 bits
 int paralign_score_i8x16(buffer_t* buffer,
@@ -270,3 +304,78 @@ int paralign_score_i32x8(buffer_t* buffer,
     return paralign_score<__m256i>(buffer, submat, gap_open, gap_extend, seq, refs, n_refs, alignments);
 }
 
+
+// both strands (128 bits)
+int paralign_score_both_i8x16(buffer_t* buffer,
+                              const submat_t<int8_t> submat,
+                              const int8_t gap_open,
+                              const int8_t gap_extend,
+                              const seq_t seq,
+                              const seq_t* refs,
+                              const int n_refs,
+                              alignment_t** alignments)
+{
+    return paralign_score_both<__m128i>(buffer, submat, gap_open, gap_extend, seq, refs, n_refs, alignments);
+}
+
+int paralign_score_both_i16x8(buffer_t* buffer,
+                              const submat_t<int16_t> submat,
+                              const int16_t gap_open,
+                              const int16_t gap_extend,
+                              const seq_t seq,
+                              const seq_t* refs,
+                              const int n_refs,
+                              alignment_t** alignments)
+{
+    return paralign_score_both<__m128i>(buffer, submat, gap_open, gap_extend, seq, refs, n_refs, alignments);
+}
+
+int paralign_score_both_i32x4(buffer_t* buffer,
+                              const submat_t<int32_t> submat,
+                              const int32_t gap_open,
+                              const int32_t gap_extend,
+                              const seq_t seq,
+                              const seq_t* refs,
+                              const int n_refs,
+                              alignment_t** alignments)
+{
+    return paralign_score_both<__m128i>(buffer, submat, gap_open, gap_extend, seq, refs, n_refs, alignments);
+}
+
+
+// both strands (256 bits)
+int paralign_score_both_i8x32(buffer_t* buffer,
+                              const submat_t<int8_t> submat,
+                              const int8_t gap_open,
+                              const int8_t gap_extend,
+                              const seq_t seq,
+                              const seq_t* refs,
+                              const int n_refs,
+                              alignment_t** alignments)
+{
+    return paralign_score_both<__m256i>(buffer, submat, gap_open, gap_extend, seq, refs, n_refs, alignments);
+}
+
+int paralign_score_both_i16x16(buffer_t* buffer,
+                               const submat_t<int16_t> submat,
+                               const int16_t gap_open,
+                               const int16_t gap_extend,
+                               const seq_t seq,
+                               const seq_t* refs,
+                               const int n_refs,
+                               alignment_t** alignments)
+{
+    return paralign_score_both<__m256i>(buffer, submat, gap_open, gap_extend, seq, refs, n_refs, alignments);
+}
+
+int paralign_score_both_i32x8(buffer_t* buffer,
+                              const submat_t<int32_t> submat,
+                              const int32_t gap_open,
+                              const int32_t gap_extend,
+                              const seq_t seq,
+                              const seq_t* refs,
+                              const int n_refs,
+                              alignment_t** alignments)
+{
+    return paralign_score_both<__m256i>(buffer, submat, gap_open, gap_extend, seq, refs, n_refs, alignments);
+}
@@ -0,0 +1,175 @@
+// parallel inter-sequence edit distance
+//
+// Bit-parallel algorithm of Myers (1999) with the block extension for long
+// queries; each SIMD lane holds the vertical delta vectors of one reference.
+
+#include <array>
+#include "simdalign.h"
+
+// vertical and horizontal deltas of a column are represented as bit-vectors
+// of the query: Pv/Mv (vertical +1/-1) and Ph/Mh (horizontal +1/-1)
+template<typename vec_t>
+static void advance_column(const uint64_t* peq,
+                           const size_t n_blocks,
+                           const int hibit,
+                           const std::array<uint8_t,sizeof(vec_t)/sizeof(uint64_t)>& refchars,
+                           vec_t hinP,
+                           vec_t& score,
+                           vec_t* Pvs,
+                           vec_t* Mvs)
+{
+    const int n = sizeof(vec_t) / sizeof(uint64_t);
+    const vec_t ones = simd_set1<int64_t,vec_t>(-1);
+    const vec_t one = simd_set1<int64_t,vec_t>(1);
+    vec_t hinN = simd_set1<int64_t,vec_t>(0);
+    for (size_t b = 0; b < n_blocks; b++) {
+        std::array<int64_t,n> eqs;
+        for (int k = 0; k < n; k++)
+            eqs[k] = peq[refchars[k] * n_blocks + b];
+        vec_t Eq = simd_set<int64_t,n,vec_t>(eqs);
+        vec_t Pv = Pvs[b];
+        vec_t Mv = Mvs[b];
+        vec_t Xv = simd_or(Eq, Mv);
+        Eq = simd_or(Eq, hinN);
+        vec_t Xh = simd_or(simd_xor(simd_add<int64_t>(simd_and(Eq, Pv), Pv), Pv), Eq);
+        vec_t Ph = simd_or(Mv, simd_andnot(simd_or(Xh, Pv), ones));
+        vec_t Mh = simd_and(Pv, Xh);
+        // carry the horizontal delta out of the highest row of this block
+        const int h = b == n_blocks - 1 ? hibit : 63;
+        vec_t houtP = simd_and(simd_srl<int64_t>(Ph, h), one);
+        vec_t houtN = simd_and(simd_srl<int64_t>(Mh, h), one);
+        Ph = simd_or(simd_sll<int64_t>(Ph, 1), hinP);
+        Mh = simd_or(simd_sll<int64_t>(Mh, 1), hinN);
+        Pvs[b] = simd_or(Mh, simd_andnot(simd_or(Xv, Ph), ones));
+        Mvs[b] = simd_and(Ph, Xv);
+        hinP = houtP;
+        hinN = houtN;
+    }
+    score = simd_sub<int64_t>(simd_add<int64_t>(score, hinP), hinN);
+}
+
+template<typename vec_t>
+int paredit_distance(buffer_t* buffer,
+                     const int mode,
+                     const seq_t seq,
+                     const seq_t* refs,
+                     const int n_refs,
+                     alignment_t** alignments)
+{
+    if (n_refs == 0)
+        return 0;
+    else if (n_refs < 0 || (mode != EDIT_GLOBAL && mode != EDIT_SEMIGLOBAL))
+        return 1;
+
+    const size_t n_blocks = (seq.len + 63) / 64;
+    const int hibit = (seq.len + 63) % 64;
+
+    // allocate working space
+    if (expand_buffer(buffer, sizeof(vec_t) * (n_blocks * 2 + 2) +
+                              sizeof(uint64_t) * 256 * n_blocks)) {
+        return 1;
+    }
+    vec_t* Pvs = (vec_t*)buffer->data;
+    vec_t* Mvs = Pvs + n_blocks;
+    vec_t* scores = Mvs + n_blocks;
+    vec_t* bests = scores + 1;
+    uint64_t* peq = reinterpret_cast<uint64_t*>(bests + 1);
+
+    const int n_max_par = sizeof(vec_t) / sizeof(uint64_t);
+
+    // bit-vectors of positions where each character occurs in seq
+    for (size_t i = 0; i < 256 * n_blocks; i++)
+        peq[i] = 0;
+    for (size_t i = 0; i < seq.len; i++)
+        peq[seq[i] * n_blocks + i / 64] |= uint64_t(1) << (i % 64);
+
+    // the first row is D[0][j] = j in global mode and 0 in semi-global mode
+    const vec_t hin = simd_set1<int64_t,vec_t>(mode == EDIT_GLOBAL ? 1 : 0);
+
+    // initialize slots which hold the reference sequences
+    std::array<slot_t,n_max_par> slots;
+    slots.fill(empty_slot);
+    int next_ref = 0;
+
+    // outer loop along refs
+    while (true) {
+        // initialize the slots and the delta vectors
+        for (int k = 0; k < n_max_par; k++) {
+            slot_t &slot = slots[k];
+
+            if (slot != empty_slot) {
+                slot.pos++;
+                if (slot.pos < refs[slot.id].len)
+                    continue;
+                else
+                    (*alignments[slot.id]).score = simd_extract<int64_t>(mode == EDIT_GLOBAL ? *scores : *bests, k);
+            }
+
+            // find the next non-empty sequences if any
+            bool found = false;
+            while (next_ref < n_refs && !found) {
+                // reset D[i][0] = i
+                for (size_t b = 0; b < n_blocks; b++) {
+                    Pvs[b] = simd_insert<int64_t>(Pvs[b], -1, k);
+                    Mvs[b] = simd_insert<int64_t>(Mvs[b], 0, k);
+                }
+                *scores = simd_insert<int64_t>(*scores, seq.len, k);
+                *bests = simd_insert<int64_t>(*bests, seq.len, k);
+                seq_t ref = refs[next_ref];
+                if (ref.len == 0) {
+                    (*alignments[next_ref++]).score = seq.len;
+                }
+                else {
+                    slot.id = next_ref++;
+                    slot.pos = 0;
+                    found = true;
+                }
+            }
+
+            if (!found)
+                slots[k] = empty_slot;
+        }
+
+        // check if there are remaining slots
+        if (is_vacant(slots))
+            break;
+
+        // characters of the current column
+        std::array<uint8_t,n_max_par> refchars;
+        for (int k = 0; k < n_max_par; k++) {
+            slot_t slot = slots[k];
+            refchars[k] = slot == empty_slot ? 0 : refs[slot.id][slot.pos];
+        }
+
+        // inner loop along seq
+        advance_column(peq, n_blocks, hibit, refchars, hin, *scores, Pvs, Mvs);
+        if (mode == EDIT_SEMIGLOBAL)
+            *bests = simd_min<int64_t>(*bests, *scores);
+    }
+
+    return 0;
+}
+
+
+// 128 bits
+int paredit_distance_i64x2(buffer_t* buffer,
+                           const int mode,
+                           const seq_t seq,
+                           const seq_t* refs,
+                           const int n_refs,
+                           alignment_t** alignments)
+{
+    return paredit_distance<__m128i>(buffer, mode, seq, refs, n_refs, alignments);
+}
+
+
+// 256 bits
+int paredit_distance_i64x4(buffer_t* buffer,
+                           const int mode,
+                           const seq_t seq,
+                           const seq_t* refs,
+                           const int n_refs,
+                           alignment_t** alignments)
+{
+    return paredit_distance<__m256i>(buffer, mode, seq, refs, n_refs, alignments);
+}
@@ -0,0 +1,339 @@
+// sharded database search with bounded memory
+
+#include <algorithm>
+#include <limits>
+#include <new>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include "simdalign.h"
+
+struct search_t
+{
+    // number of references aligned at once
+    size_t shard_size;
+    // number of hits kept (0: all hits above the threshold, unbounded)
+    size_t top_k;
+    // minimum score of hits
+    int64_t threshold;
+    // number of references searched so far (the ID of the next reference)
+    uint64_t n_done;
+    // hash of the query, the scoring and the kernel (0: not yet searched)
+    uint64_t fingerprint;
+    // hits; a heap with the worst hit at the front if top_k > 0
+    std::vector<hit_t> hits;
+
+    // per-shard workspace reused across shards
+    buffer_t* buffer;
+    std::vector<alignment_t> alns;
+    std::vector<alignment_t*> ptrs;
+};
+
+template<typename score_t>
+using kernel_t = int (*)(buffer_t*,
+                         const submat_t<score_t>,
+                         const score_t,
+                         const score_t,
+                         const seq_t,
+                         const seq_t*,
+                         const int,
+                         alignment_t**);
+
+// higher score first, then smaller ID
+static inline bool is_better(const hit_t& x, const hit_t& y)
+{
+    return x.score > y.score || (x.score == y.score && x.ref_id < y.ref_id);
+}
+
+static void add_hit(search_t* search, const hit_t hit)
+{
+    if (hit.score < search->threshold)
+        return;
+    std::vector<hit_t>& hits = search->hits;
+    if (search->top_k == 0) {
+        hits.push_back(hit);
+    }
+    else if (hits.size() < search->top_k) {
+        hits.push_back(hit);
+        std::push_heap(hits.begin(), hits.end(), is_better);
+    }
+    else if (is_better(hit, hits.front())) {
+        std::pop_heap(hits.begin(), hits.end(), is_better);
+        hits.back() = hit;
+        std::push_heap(hits.begin(), hits.end(), is_better);
+    }
+}
+
+// FNV-1a hash
+static inline uint64_t hash_bytes(uint64_t h, const void* data, const size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        h ^= static_cast<const uint8_t*>(data)[i];
+        h *= 0x100000001b3;
+    }
+    return h;
+}
+
+// identify the query, the scoring and the kernel so that a resumed search cannot mix them
+template<typename score_t>
+static uint64_t fingerprint(const char* kernel_name,
+                            const submat_t<score_t> submat,
+                            const score_t gap_open,
+                            const score_t gap_extend,
+                            const seq_t seq)
+{
+    uint64_t h = 0xcbf29ce484222325;
+    h = hash_bytes(h, kernel_name, strlen(kernel_name));
+    h = hash_bytes(h, &submat.size, sizeof(submat.size));
+    h = hash_bytes(h, submat.data, sizeof(score_t) * submat.size * submat.size);
+    h = hash_bytes(h, &gap_open, sizeof(score_t));
+    h = hash_bytes(h, &gap_extend, sizeof(score_t));
+    h = hash_bytes(h, &seq.len, sizeof(seq.len));
+    for (size_t i = 0; i < seq.len; i++) {
+        uint8_t x = seq[i];
+        h = hash_bytes(h, &x, 1);
+    }
+    return h == 0 ? 1 : h;
+}
+
+template<typename score_t>
+static int search_shard(kernel_t<score_t> kernel,
+                        const char* kernel_name,
+                        search_t* search,
+                        const submat_t<score_t> submat,
+                        const score_t gap_open,
+                        const score_t gap_extend,
+                        const seq_t seq,
+                        const seq_t* refs,
+                        const size_t n_refs)
+{
+    const uint64_t h = fingerprint(kernel_name, submat, gap_open, gap_extend, seq);
+    if (search->fingerprint == 0)
+        search->fingerprint = h;
+    else if (search->fingerprint != h)
+        return 2;
+
+    for (size_t start = 0; start < n_refs; start += search->shard_size) {
+        const int n = std::min(search->shard_size, n_refs - start);
+        if (kernel(search->buffer, submat, gap_open, gap_extend, seq, refs + start, n, search->ptrs.data()))
+            return 1;
+        try {
+            for (int i = 0; i < n; i++)
+                add_hit(search, hit_t{search->n_done + i, search->alns[i].score});
+        }
+        catch (...) {
+            return 1;
+        }
+        search->n_done += n;
+    }
+    return 0;
+}
+
+
+search_t* make_search(size_t shard_size, size_t top_k, int64_t threshold)
+{
+    if (shard_size == 0 || shard_size > static_cast<size_t>(std::numeric_limits<int>::max()))
+        return nullptr;
+    search_t* search = new (std::nothrow) search_t;
+    if (search == nullptr)
+        return nullptr;
+    search->shard_size = shard_size;
+    search->top_k = top_k;
+    search->threshold = threshold;
+    search->n_done = 0;
+    search->fingerprint = 0;
+    search->buffer = make_buffer();
+    // these are called from Julia, so an allocation failure must not escape as an exception
+    try {
+        search->alns.assign(shard_size, alignment_t(0));
+        search->ptrs.reserve(shard_size);
+        for (alignment_t& aln : search->alns)
+            search->ptrs.push_back(&aln);
+    }
+    catch (...) {
+        free_search(search);
+        return nullptr;
+    }
+    return search;
+}
+
+void free_search(search_t* search)
+{
+    free_buffer(search->buffer);
+    delete search;
+}
+
+uint64_t search_n_done(const search_t* search)
+{
+    return search->n_done;
+}
+
+size_t search_n_hits(const search_t* search)
+{
+    return search->hits.size();
+}
+
+int search_hits(const search_t* search, hit_t* hits)
+{
+    std::copy(search->hits.begin(), search->hits.end(), hits);
+    std::sort(hits, hits + search->hits.size(), is_better);
+    return 0;
+}
+
+// number of bytes from the current position to the end of file, or -1 on error
+static long remaining_bytes(FILE* file)
+{
+    const long pos = ftell(file);
+    if (pos < 0 || fseek(file, 0, SEEK_END) != 0)
+        return -1;
+    const long end = ftell(file);
+    if (end < pos || fseek(file, pos, SEEK_SET) != 0)
+        return -1;
+    return end - pos;
+}
+
+// checkpoint file: magic, shard_size, top_k, threshold, fingerprint, n_done, n_hits, hits
+static const char checkpoint_magic[8] = {'S', 'I', 'M', 'D', 'S', 'R', 'C', '2'};
+
+int save_search(const search_t* search, const char* path)
+{
+    // write to a temporary file and rename it so that a crash never leaves a broken checkpoint
+    std::string tmppath = std::string(path) + ".tmp";
+    FILE* file = fopen(tmppath.c_str(), "wb");
+    if (file == NULL)
+        return 1;
+    const uint64_t n_hits = search->hits.size();
+    bool ok = fwrite(checkpoint_magic, sizeof(checkpoint_magic), 1, file) == 1 &&
+              fwrite(&search->shard_size, sizeof(size_t), 1, file) == 1 &&
+              fwrite(&search->top_k, sizeof(size_t), 1, file) == 1 &&
+              fwrite(&search->threshold, sizeof(int64_t), 1, file) == 1 &&
+              fwrite(&search->fingerprint, sizeof(uint64_t), 1, file) == 1 &&
+              fwrite(&search->n_done, sizeof(uint64_t), 1, file) == 1 &&
+              fwrite(&n_hits, sizeof(uint64_t), 1, file) == 1 &&
+              fwrite(search->hits.data(), sizeof(hit_t), n_hits, file) == n_hits;
+    if (fclose(file) != 0 || !ok || rename(tmppath.c_str(), path) != 0) {
+        remove(tmppath.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+search_t* load_search(const char* path, size_t shard_size, size_t top_k, int64_t threshold)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return nullptr;
+    char magic[8];
+    size_t saved_shard_size, saved_top_k;
+    int64_t saved_threshold;
+    uint64_t fingerprint, n_done, n_hits;
+    search_t* search = nullptr;
+    if (fread(magic, sizeof(magic), 1, file) == 1 &&
+        std::equal(magic, magic + sizeof(magic), checkpoint_magic) &&
+        fread(&saved_shard_size, sizeof(size_t), 1, file) == 1 &&
+        fread(&saved_top_k, sizeof(size_t), 1, file) == 1 &&
+        fread(&saved_threshold, sizeof(int64_t), 1, file) == 1 &&
+        fread(&fingerprint, sizeof(uint64_t), 1, file) == 1 &&
+        fread(&n_done, sizeof(uint64_t), 1, file) == 1 &&
+        fread(&n_hits, sizeof(uint64_t), 1, file) == 1 &&
+        saved_shard_size == shard_size &&
+        saved_top_k == top_k &&
+        saved_threshold == threshold &&
+        (top_k == 0 || n_hits <= top_k)) {
+        // a corrupted n_hits must not make us allocate more than the file holds
+        const long remaining = remaining_bytes(file);
+        if (remaining >= 0 && n_hits == static_cast<uint64_t>(remaining) / sizeof(hit_t))
+            search = make_search(shard_size, top_k, threshold);
+        if (search != nullptr) {
+            search->n_done = n_done;
+            search->fingerprint = fingerprint;
+            bool ok;
+            try {
+                search->hits.resize(n_hits);
+                ok = fread(search->hits.data(), sizeof(hit_t), n_hits, file) == n_hits;
+            }
+            catch (...) {
+                ok = false;
+            }
+            if (!ok) {
+                free_search(search);
+                search = nullptr;
+            }
+            else if (top_k > 0) {
+                std::make_heap(search->hits.begin(), search->hits.end(), is_better);
+            }
+        }
+    }
+    fclose(file);
+    return search;
+}
+
+
+// 128 bits
+int search_shard_i8x16(search_t* search,
+                       const submat_t<int8_t> submat,
+                       const int8_t gap_open,
+                       const int8_t gap_extend,
+                       const seq_t seq,
+                       const seq_t* refs,
+                       const size_t n_refs)
+{
+    return search_shard(paralign_score_i8x16, "i8x16", search, submat, gap_open, gap_extend, seq, refs, n_refs);
+}
+
+int search_shard_i16x8(search_t* search,
+                       const submat_t<int16_t> submat,
+                       const int16_t gap_open,
+                       const int16_t gap_extend,
+                       const seq_t seq,
+                       const seq_t* refs,
+                       const size_t n_refs)
+{
+    return search_shard(paralign_score_i16x8, "i16x8", search, submat, gap_open, gap_extend, seq, refs, n_refs);
+}
+
+int search_shard_i32x4(search_t* search,
+                       const submat_t<int32_t> submat,
+                       const int32_t gap_open,
+                       const int32_t gap_extend,
+                       const seq_t seq,
+                       const seq_t* refs,
+                       const size_t n_refs)
+{
+    return search_shard(paralign_score_i32x4, "i32x4", search, submat, gap_open, gap_extend, seq, refs, n_refs);
+}
+
+
+// 256 bits
+int search_shard_i8x32(search_t* search,
+                       const submat_t<int8_t> submat,
+                       const int8_t gap_open,
+                       const int8_t gap_extend,
+                       const seq_t seq,
+                       const seq_t* refs,
+                       const size_t n_refs)
+{
+    return search_shard(paralign_score_i8x32, "i8x32", search, submat, gap_open, gap_extend, seq, refs, n_refs);
+}
+
+int search_shard_i16x16(search_t* search,
+                        const submat_t<int16_t> submat,
+                        const int16_t gap_open,
+                        const int16_t gap_extend,
+                        const seq_t seq,
+                        const seq_t* refs,
+                        const size_t n_refs)
+{
+    return search_shard(paralign_score_i16x16, "i16x16", search, submat, gap_open, gap_extend, seq, refs, n_refs);
+}
+
+int search_shard_i32x8(search_t* search,
+                       const submat_t<int32_t> submat,
+                       const int32_t gap_open,
+                       const int32_t gap_extend,
+                       const seq_t seq,
+                       const seq_t* refs,
+                       const size_t n_refs)
+{
+    return search_shard(paralign_score_i32x8, "i32x8", search, submat, gap_open, gap_extend, seq, refs, n_refs);
+}
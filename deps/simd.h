@@ -2,6 +2,7 @@
 #define SIMD_H
 
 #include <array>
+#include <cstring>
 #include <type_traits>
 #include <x86intrin.h>
 #include <immintrin.h>
@@ -30,6 +31,12 @@ inline __m128i simd_set1(const int32_t x)
     return _mm_set1_epi32(x);
 }
 
+template<>
+inline __m128i simd_set1(const int64_t x)
+{
+    return _mm_set1_epi64x(x);
+}
+
 template<>
 inline __m256i simd_set1(const int8_t x)
 {
@@ -48,6 +55,12 @@ inline __m256i simd_set1(const int32_t x)
     return _mm256_set1_epi32(x);
 }
 
+template<>
+inline __m256i simd_set1(const int64_t x)
+{
+    return _mm256_set1_epi64x(x);
+}
+
 
 // set
 template<typename T,size_t n,typename V>
@@ -81,6 +94,14 @@ inline __m128i simd_set(const std::array<int32_t,4>& xs)
     );
 }
 
+template<>
+inline __m128i simd_set(const std::array<int64_t,2>& xs)
+{
+    return _mm_set_epi64x(
+        xs[1], xs[0]
+    );
+}
+
 template<>
 inline __m256i simd_set(const std::array<int8_t,32>& xs)
 {
@@ -116,6 +137,14 @@ inline __m256i simd_set(const std::array<int32_t,8>& xs)
     );
 }
 
+template<>
+inline __m256i simd_set(const std::array<int64_t,4>& xs)
+{
+    return _mm256_set_epi64x(
+        xs[3], xs[2], xs[1], xs[0]
+    );
+}
+
 // max
 template<typename T,typename V>
 inline V simd_max(const V x, const V y);
@@ -142,6 +171,36 @@ inline __m256i simd_max(const __m256i x, const __m256i y)
         return _mm256_max_epi32(x, y);
 }
 
+// min
+template<typename T,typename V>
+inline V simd_min(const V x, const V y);
+
+template<typename T>
+inline __m128i simd_min(const __m128i x, const __m128i y)
+{
+    if (T_IS(int8_t))
+        return _mm_min_epi8(x, y);
+    if (T_IS(int16_t))
+        return _mm_min_epi16(x, y);
+    if (T_IS(int32_t))
+        return _mm_min_epi32(x, y);
+    if (T_IS(int64_t))
+        return _mm_blendv_epi8(x, y, _mm_cmpgt_epi64(x, y));
+}
+
+template<typename T>
+inline __m256i simd_min(const __m256i x, const __m256i y)
+{
+    if (T_IS(int8_t))
+        return _mm256_min_epi8(x, y);
+    if (T_IS(int16_t))
+        return _mm256_min_epi16(x, y);
+    if (T_IS(int32_t))
+        return _mm256_min_epi32(x, y);
+    if (T_IS(int64_t))
+        return _mm256_blendv_epi8(x, y, _mm256_cmpgt_epi64(x, y));
+}
+
 // add (saturated)
 template<typename T,typename V>
 inline V simd_adds(const V x, const V y);
@@ -177,6 +236,8 @@ inline __m128i simd_add(const __m128i x, const __m128i y)
         return _mm_add_epi16(x, y);
     if (T_IS(int32_t))
         return _mm_add_epi32(x, y);
+    if (T_IS(int64_t))
+        return _mm_add_epi64(x, y);
 }
 
 template<typename T>
@@ -188,6 +249,8 @@ inline __m256i simd_add(const __m256i x, const __m256i y)
         return _mm256_add_epi16(x, y);
     if (T_IS(int32_t))
         return _mm256_add_epi32(x, y);
+    if (T_IS(int64_t))
+        return _mm256_add_epi64(x, y);
 }
 
 // sub (saturated)
@@ -225,6 +288,8 @@ inline __m128i simd_sub(const __m128i x, const __m128i y)
         return _mm_sub_epi16(x, y);
     if (T_IS(int32_t))
         return _mm_sub_epi32(x, y);
+    if (T_IS(int64_t))
+        return _mm_sub_epi64(x, y);
 }
 
 template<typename T>
@@ -236,58 +301,123 @@ inline __m256i simd_sub(const __m256i x, const __m256i y)
         return _mm256_sub_epi16(x, y);
     if (T_IS(int32_t))
         return _mm256_sub_epi32(x, y);
+    if (T_IS(int64_t))
+        return _mm256_sub_epi64(x, y);
 }
 
-// extract
+// shift left (logical)
 template<typename T,typename V>
-inline int simd_extract(const V x, const int m);
+inline V simd_sll(const V x, const int n);
 
 template<typename T>
-inline int simd_extract(const __m128i x, const int m)
+inline __m128i simd_sll(const __m128i x, const int n)
 {
-    if (T_IS(int8_t))
-        return _mm_extract_epi8(x, m);
     if (T_IS(int16_t))
-        return _mm_extract_epi16(x, m);
+        return _mm_sll_epi16(x, _mm_cvtsi32_si128(n));
     if (T_IS(int32_t))
-        return _mm_extract_epi32(x, m);
+        return _mm_sll_epi32(x, _mm_cvtsi32_si128(n));
+    if (T_IS(int64_t))
+        return _mm_sll_epi64(x, _mm_cvtsi32_si128(n));
 }
 
 template<typename T>
-inline int simd_extract(const __m256i x, const int m)
+inline __m256i simd_sll(const __m256i x, const int n)
 {
-    if (T_IS(int8_t))
-        return _mm256_extract_epi8(x, m);
     if (T_IS(int16_t))
-        return _mm256_extract_epi16(x, m);
+        return _mm256_sll_epi16(x, _mm_cvtsi32_si128(n));
     if (T_IS(int32_t))
-        return _mm256_extract_epi32(x, m);
+        return _mm256_sll_epi32(x, _mm_cvtsi32_si128(n));
+    if (T_IS(int64_t))
+        return _mm256_sll_epi64(x, _mm_cvtsi32_si128(n));
 }
 
-// insert
+// shift right (logical)
 template<typename T,typename V>
-inline V simd_insert(const V x, const T y, const int m);
+inline V simd_srl(const V x, const int n);
 
 template<typename T>
-inline __m128i simd_insert(const __m128i x, const T y, const int m)
+inline __m128i simd_srl(const __m128i x, const int n)
 {
-    if (T_IS(int8_t))
-        return _mm_insert_epi8(x, y, m);
     if (T_IS(int16_t))
-        return _mm_insert_epi16(x, y, m);
+        return _mm_srl_epi16(x, _mm_cvtsi32_si128(n));
     if (T_IS(int32_t))
-        return _mm_insert_epi32(x, y, m);
+        return _mm_srl_epi32(x, _mm_cvtsi32_si128(n));
+    if (T_IS(int64_t))
+        return _mm_srl_epi64(x, _mm_cvtsi32_si128(n));
 }
 
 template<typename T>
-inline __m256i simd_insert(const __m256i x, const T y, const int m)
+inline __m256i simd_srl(const __m256i x, const int n)
 {
-    if (T_IS(int8_t))
-        return _mm256_insert_epi8(x, y, m);
     if (T_IS(int16_t))
-        return _mm256_insert_epi16(x, y, m);
+        return _mm256_srl_epi16(x, _mm_cvtsi32_si128(n));
     if (T_IS(int32_t))
-        return _mm256_insert_epi32(x, y, m);
+        return _mm256_srl_epi32(x, _mm_cvtsi32_si128(n));
+    if (T_IS(int64_t))
+        return _mm256_srl_epi64(x, _mm_cvtsi32_si128(n));
+}
+
+// bitwise operations
+inline __m128i simd_and(const __m128i x, const __m128i y)
+{
+    return _mm_and_si128(x, y);
+}
+
+inline __m256i simd_and(const __m256i x, const __m256i y)
+{
+    return _mm256_and_si256(x, y);
+}
+
+inline __m128i simd_or(const __m128i x, const __m128i y)
+{
+    return _mm_or_si128(x, y);
+}
+
+inline __m256i simd_or(const __m256i x, const __m256i y)
+{
+    return _mm256_or_si256(x, y);
+}
+
+inline __m128i simd_xor(const __m128i x, const __m128i y)
+{
+    return _mm_xor_si128(x, y);
+}
+
+inline __m256i simd_xor(const __m256i x, const __m256i y)
+{
+    return _mm256_xor_si256(x, y);
+}
+
+// ~x & y
+inline __m128i simd_andnot(const __m128i x, const __m128i y)
+{
+    return _mm_andnot_si128(x, y);
+}
+
+inline __m256i simd_andnot(const __m256i x, const __m256i y)
+{
+    return _mm256_andnot_si256(x, y);
+}
+
+// extract
+template<typename T,typename V>
+inline T simd_extract(const V x, const int m)
+{
+    T xs[sizeof(V) / sizeof(T)];
+    std::memcpy(xs, &x, sizeof(V));
+    return xs[m];
+}
+
+// insert
+template<typename T,typename V>
+inline V simd_insert(const V x, const T y, const int m)
+{
+    T xs[sizeof(V) / sizeof(T)];
+    std::memcpy(xs, &x, sizeof(V));
+    xs[m] = y;
+    V z;
+    std::memcpy(&z, xs, sizeof(V));
+    return z;
 }
 
 #undef T_IS
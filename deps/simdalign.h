@@ -1,6 +1,7 @@
 #ifndef SIMDALIGN_H
 #define SIMDALIGN_H
 
+#include <array>
 #include <vector>
 #include "stdlib.h"
 #include "stdint.h"
@@ -18,20 +19,31 @@ struct seq_t
     const bool reversed;
     // whether the seqnece is packed, used for DNA/RNA sequence
     const bool packed;
+    // complement packed nucleotides on access (A <-> T, C <-> G)
+    const bool complemented;
 
-    seq_t(const std::vector<uint8_t>& data) : data(data.data()), len(data.size()), offset(0), reversed(false), packed(false) {}
+    seq_t(const std::vector<uint8_t>& data) : data(data.data()), len(data.size()), offset(0), reversed(false), packed(false), complemented(false) {}
+    seq_t(const uint8_t* data, size_t len, size_t offset, bool reversed, bool packed, bool complemented) :
+        data(data), len(len), offset(offset), reversed(reversed), packed(packed), complemented(complemented) {}
 
     // NOTE: 0-based index unlike Julia
     inline uint8_t operator[](const size_t i) const {
         size_t j = offset + (reversed ? -i : i);
         if (packed) {
             size_t q = j >> 2, r = j & 0b11;
-            return (data[q] >> (r * 2)) & 0b11;
+            uint8_t x = (data[q] >> (r * 2)) & 0b11;
+            return complemented ? x ^ 0b11 : x;
         }
         else {
             return data[j];
         }
     };
+
+    // reverse complement view of the same data (packed sequence only)
+    inline seq_t revcomp() const {
+        size_t last = len == 0 ? offset : reversed ? offset - (len - 1) : offset + (len - 1);
+        return seq_t(data, len, last, !reversed, packed, !complemented);
+    };
 };
 
 
@@ -62,6 +74,8 @@ struct alignment_t
     size_t reflen;
     size_t endpos_seq;
     size_t endpos_ref;
+    // strand of the query: 0 (forward) or 1 (reverse complement)
+    int8_t strand;
 
     // score-only constructor
     alignment_t(const int64_t score) :
@@ -70,9 +84,58 @@ struct alignment_t
         seqlen(0),
         reflen(0),
         endpos_seq(0),
-        endpos_ref(0) {}
+        endpos_ref(0),
+        strand(0) {}
+};
+
+// edit distance mode
+enum editmode_t
+{
+    // whole seq against whole ref
+    EDIT_GLOBAL = 0,
+    // whole seq against any substring of ref (search)
+    EDIT_SEMIGLOBAL = 1
+};
+
+// search hit
+struct hit_t
+{
+    // 0-based position of the reference in the database
+    uint64_t ref_id;
+    int64_t score;
+};
+
+// state of a sharded database search (defined in shard.cpp)
+struct search_t;
+
+// slot of a SIMD lane holding a reference sequence
+struct slot_t
+{
+    int id;
+    size_t pos;
+
+    slot_t() {}
+    slot_t(int id, size_t pos) : id(id), pos(pos) {}
+
+    inline bool operator==(const slot_t &other) const {
+        return id == other.id;
+    }
+    inline bool operator!=(const slot_t &other) const {
+        return id != other.id;
+    }
 };
 
+const slot_t empty_slot = slot_t(-1, 0);
+
+template<size_t n>
+inline bool is_vacant(const std::array<slot_t,n> slots)
+{
+    for (const slot_t& slot : slots)
+        if (slot != empty_slot)
+            return false;
+    return true;
+}
+
 // working space
 struct buffer_t
 {
@@ -136,6 +199,124 @@ extern "C"
                              const seq_t* refs,
                              const int n_refs,
                              alignment_t** alignments);
+
+    // both strands: align seq and its reverse complement (seq must be packed)
+    int paralign_score_both_i8x16(buffer_t* buffer,
+                                  const submat_t<int8_t> submat,
+                                  const int8_t gap_open,
+                                  const int8_t gap_extend,
+                                  const seq_t seq,
+                                  const seq_t* refs,
+                                  const int n_refs,
+                                  alignment_t** alignments);
+    int paralign_score_both_i16x8(buffer_t* buffer,
+                                  const submat_t<int16_t> submat,
+                                  const int16_t gap_open,
+                                  const int16_t gap_extend,
+                                  const seq_t seq,
+                                  const seq_t* refs,
+                                  const int n_refs,
+                                  alignment_t** alignments);
+    int paralign_score_both_i32x4(buffer_t* buffer,
+                                  const submat_t<int32_t> submat,
+                                  const int32_t gap_open,
+                                  const int32_t gap_extend,
+                                  const seq_t seq,
+                                  const seq_t* refs,
+                                  const int n_refs,
+                                  alignment_t** alignments);
+    int paralign_score_both_i8x32(buffer_t* buffer,
+                                  const submat_t<int8_t> submat,
+                                  const int8_t gap_open,
+                                  const int8_t gap_extend,
+                                  const seq_t seq,
+                                  const seq_t* refs,
+                                  const int n_refs,
+                                  alignment_t** alignments);
+    int paralign_score_both_i16x16(buffer_t* buffer,
+                                   const submat_t<int16_t> submat,
+                                   const int16_t gap_open,
+                                   const int16_t gap_extend,
+                                   const seq_t seq,
+                                   const seq_t* refs,
+                                   const int n_refs,
+                                   alignment_t** alignments);
+    int paralign_score_both_i32x8(buffer_t* buffer,
+                                  const submat_t<int32_t> submat,
+                                  const int32_t gap_open,
+                                  const int32_t gap_extend,
+                                  const seq_t seq,
+                                  const seq_t* refs,
+                                  const int n_refs,
+                                  alignment_t** alignments);
+
+    // paredit.cpp (score: unit-cost edit distance)
+    int paredit_distance_i64x2(buffer_t* buffer,
+                               const int mode,
+                               const seq_t seq,
+                               const seq_t* refs,
+                               const int n_refs,
+                               alignment_t** alignments);
+    int paredit_distance_i64x4(buffer_t* buffer,
+                               const int mode,
+                               const seq_t seq,
+                               const seq_t* refs,
+                               const int n_refs,
+                               alignment_t** alignments);
+
+    // shard.cpp (top_k = 0 keeps every hit above the threshold: memory is unbounded)
+    search_t* make_search(size_t shard_size, size_t top_k, int64_t threshold);
+    void free_search(search_t* search);
+    uint64_t search_n_done(const search_t* search);
+    size_t search_n_hits(const search_t* search);
+    int search_hits(const search_t* search, hit_t* hits);
+    int save_search(const search_t* search, const char* path);
+    // NULL if the checkpoint is broken or made with other parameters
+    search_t* load_search(const char* path, size_t shard_size, size_t top_k, int64_t threshold);
+    // align refs as the next n_refs references of the database; return 2 if
+    // the query, the scoring or the kernel differs from the previous shards
+    int search_shard_i8x16(search_t* search,
+                           const submat_t<int8_t> submat,
+                           const int8_t gap_open,
+                           const int8_t gap_extend,
+                           const seq_t seq,
+                           const seq_t* refs,
+                           const size_t n_refs);
+    int search_shard_i16x8(search_t* search,
+                           const submat_t<int16_t> submat,
+                           const int16_t gap_open,
+                           const int16_t gap_extend,
+                           const seq_t seq,
+                           const seq_t* refs,
+                           const size_t n_refs);
+    int search_shard_i32x4(search_t* search,
+                           const submat_t<int32_t> submat,
+                           const int32_t gap_open,
+                           const int32_t gap_extend,
+                           const seq_t seq,
+                           const seq_t* refs,
+                           const size_t n_refs);
+    int search_shard_i8x32(search_t* search,
+                           const submat_t<int8_t> submat,
+                           const int8_t gap_open,
+                           const int8_t gap_extend,
+                           const seq_t seq,
+                           const seq_t* refs,
+                           const size_t n_refs);
+    int search_shard_i16x16(search_t* search,
+                            const submat_t<int16_t> submat,
+                            const int16_t gap_open,
+                            const int16_t gap_extend,
+                            const seq_t seq,
+                            const seq_t* refs,
+                            const size_t n_refs);
+    int search_shard_i32x8(search_t* search,
+                           const submat_t<int32_t> submat,
+                           const int32_t gap_open,
+                           const int32_t gap_extend,
+                           const seq_t seq,
+                           const seq_t* refs,
+                           const size_t n_refs);
 }
 
 #endif
@@ -5,8 +5,15 @@ export
     seq_t,
     submat_t,
     alignment_t,
+    hit_t,
+    # edit distance modes
+    EDIT_GLOBAL,
+    EDIT_SEMIGLOBAL,
     # functions
-    paralign_score
+    paralign_score,
+    paralign_score_both,
+    paredit_distance,
+    search_sharded
 
 import Bio
 using Bio.Seq
@@ -22,19 +29,20 @@ immutable seq_t
     offset::Csize_t
     reversed::Bool
     packed::Bool
+    complemented::Bool
 end
 
 function Base.convert{T<:Byte}(::Type{seq_t}, seq::Vector{T})
-    return seq_t(pointer(seq), length(seq), 0, false, false)
+    return seq_t(pointer(seq), length(seq), 0, false, false, false)
 end
 
 function Base.call(::Type{seq_t}, seq::Vector, offset::Int=0, reversed::Bool=false)
-    return seq_t(pointer(seq), length(seq), offset, reversed, false)
+    return seq_t(pointer(seq), length(seq), offset, reversed, false, false)
 end
 
 function Base.convert(::Type{seq_t}, seq::NucleotideSequence)
     byteseq = reinterpret(UInt8, seq.data)
-    return seq_t(pointer(byteseq), length(seq), seq.part.start - 1, false, true)
+    return seq_t(pointer(byteseq), length(seq), seq.part.start - 1, false, true, false)
 end
 
 function Base.call{T}(::Type{seq_t}, seq::NucleotideSequence{T}, reversed::Bool=false)
@@ -45,7 +53,7 @@ function Base.call{T}(::Type{seq_t}, seq::NucleotideSequence{T}, reversed::Bool=
     else
         offset = (reversed ? seq.part.stop : seq.part.start) - 1
     end
-    return seq_t(pointer(byteseq), length(seq), offset, reversed, true)
+    return seq_t(pointer(byteseq), length(seq), offset, reversed, true, false)
 end
 
 # substitution matrix
@@ -72,8 +80,9 @@ type alignment_t
     reflen::Csize_t
     endpos_seq::Csize_t
     endpos_ref::Csize_t
+    strand::Int8
     function alignment_t()
-        return new(0, C_NULL, 0, 0, 0, 0)
+        return new(0, C_NULL, 0, 0, 0, 0, 0)
     end
 end
 
@@ -85,6 +94,16 @@ function Base.show(io::IO, aln::alignment_t)
     print(io, aln.score)
 end
 
+# search hit (ref_id is 0-based)
+immutable hit_t
+    ref_id::UInt64
+    score::Int64
+end
+
+function Bio.Align.score(hit::hit_t)
+    return hit.score
+end
+
 
 const libsimdalign = Pkg.dir("SIMDAlignment", "deps", "libsimdalign.so")
 
@@ -98,11 +117,17 @@ function free_buffer(buffer)
     ccall((:free_buffer, libsimdalign), Void, (Ptr{Void},), buffer)
 end
 
-@generated function paralign_score{score_t}(submat::Matrix{score_t}, gap_open::score_t, gap_extend::score_t, seq::seq_t, refs::Vector{seq_t})
-    func = score_t === Int8  ? :(:paralign_score_i8x32)  :
-           score_t === Int16 ? :(:paralign_score_i16x16) :
-           score_t === Int32 ? :(:paralign_score_i32x8) :
-           error("not supported type: $score_t")
+# kernel name of the widest SIMD vector for score_t (e.g. :paralign_score_i8x32)
+function simd_kernel(name, score_t)
+    width = score_t === Int8  ? "i8x32"  :
+            score_t === Int16 ? "i16x16" :
+            score_t === Int32 ? "i32x8"  :
+            error("not supported type: $score_t")
+    return symbol(name, "_", width)
+end
+
+# call a one-to-many alignment kernel func
+@generated function paralign_kernel{func,score_t}(::Type{Val{func}}, submat::Matrix{score_t}, gap_open::score_t, gap_extend::score_t, seq::seq_t, refs::Vector{seq_t})
     quote
         alns = Vector{alignment_t}()
         for _ in 1:length(refs)
@@ -110,7 +135,7 @@ end
         end
         buffer = make_buffer()
         ret = ccall(
-            ($(func), libsimdalign),
+            ($(QuoteNode(func)), libsimdalign),
             Cint,
             (Ptr{Void}, submat_t{score_t}, score_t, score_t, seq_t, Ptr{seq_t}, Cint, Ptr{Void}),
             buffer, submat_t(submat), gap_open, gap_extend, seq, pointer(refs), length(refs), alns
@@ -121,6 +146,11 @@ end
     end
 end
 
+@generated function paralign_score{score_t}(submat::Matrix{score_t}, gap_open::score_t, gap_extend::score_t, seq::seq_t, refs::Vector{seq_t})
+    func = simd_kernel(:paralign_score, score_t)
+    :(paralign_kernel(Val{$(QuoteNode(func))}, submat, gap_open, gap_extend, seq, refs))
+end
+
 function paralign_score{score_t}(submat::Union{Matrix{score_t},SubstitutionMatrix{score_t}}, gap_open, gap_extend, seq, refs)
     paralign_score(
         convert(Matrix{score_t}, submat),
@@ -131,4 +161,125 @@ function paralign_score{score_t}(submat::Union{Matrix{score_t},SubstitutionMatri
     )
 end
 
+# align seq and its reverse complement; strand of each result is 0 (forward) or 1 (reverse complement)
+@generated function paralign_score_both{score_t}(submat::Matrix{score_t}, gap_open::score_t, gap_extend::score_t, seq::seq_t, refs::Vector{seq_t})
+    func = simd_kernel(:paralign_score_both, score_t)
+    :(paralign_kernel(Val{$(QuoteNode(func))}, submat, gap_open, gap_extend, seq, refs))
+end
+
+function paralign_score_both{score_t}(submat::Union{Matrix{score_t},SubstitutionMatrix{score_t}}, gap_open, gap_extend, seq::NucleotideSequence, refs)
+    paralign_score_both(
+        convert(Matrix{score_t}, submat),
+        score_t(gap_open),
+        score_t(gap_extend),
+        seq_t(seq),
+        [seq_t(ref) for ref in refs]
+    )
+end
+
+# edit distance mode (editmode_t)
+const EDIT_GLOBAL     = Cint(0)
+const EDIT_SEMIGLOBAL = Cint(1)
+
+# unit-cost edit distance; the score of each alignment is the distance
+function paredit_distance(seq, refs; mode::Integer=EDIT_GLOBAL)
+    refs′ = [seq_t(ref) for ref in refs]
+    alns = Vector{alignment_t}()
+    for _ in 1:length(refs′)
+        push!(alns, alignment_t())
+    end
+    buffer = make_buffer()
+    ret = ccall(
+        (:paredit_distance_i64x4, libsimdalign),
+        Cint,
+        (Ptr{Void}, Cint, seq_t, Ptr{seq_t}, Cint, Ptr{Void}),
+        buffer, Cint(mode), seq_t(seq), pointer(refs′), length(refs′), alns
+    )
+    free_buffer(buffer)
+    @assert ret == 0 "failed to align"
+    return alns
+end
+
+# sharded search
+seqof(seq) = seq
+seqof(rec::SeqRecord) = rec.seq
+
+@generated function search_shard{score_t}(search::Ptr{Void}, submat::Matrix{score_t}, gap_open::score_t, gap_extend::score_t, seq::seq_t, refs::Vector{seq_t})
+    func = simd_kernel(:search_shard, score_t)
+    quote
+        ret = ccall(
+            ($(QuoteNode(func)), libsimdalign),
+            Cint,
+            (Ptr{Void}, submat_t{score_t}, score_t, score_t, seq_t, Ptr{seq_t}, Csize_t),
+            search, submat_t(submat), gap_open, gap_extend, seq, pointer(refs), length(refs)
+        )
+        ret == 2 && error("the query or the scoring differs from the checkpoint")
+        @assert ret == 0 "failed to align"
+    end
+end
+
+"""
+Search `seq` against a database of `refs` walking it in shards of `shard_size`
+references, and return the best `top_k` hits with a score of at least
+`threshold`, best first. With `top_k == 0` every hit above the threshold is
+kept, so memory grows with the database unless the threshold is selective.
+
+`refs` may be any iterable of sequences or sequence records, including a FASTA
+file opened with `open(filename, FASTA)`. If `checkpoint` is given, the progress
+is saved there after each shard and an interrupted search resumes from it; the
+checkpoint must have been made with the same query, scoring and keyword
+arguments, and is removed once the whole database has been searched.
+"""
+function search_sharded{score_t}(submat::Union{Matrix{score_t},SubstitutionMatrix{score_t}}, gap_open, gap_extend, seq, refs;
+                                 shard_size::Integer=100_000, top_k::Integer=100, threshold::Integer=typemin(Int64), checkpoint::AbstractString="")
+    submat = convert(Matrix{score_t}, submat)
+    gap_open = score_t(gap_open)
+    gap_extend = score_t(gap_extend)
+    seq′ = seq_t(seq)
+
+    if !isempty(checkpoint) && isfile(checkpoint)
+        search = ccall((:load_search, libsimdalign), Ptr{Void}, (Cstring, Csize_t, Csize_t, Int64), checkpoint, shard_size, top_k, threshold)
+        search == C_NULL && error("checkpoint $checkpoint is broken or made with other shard_size, top_k or threshold")
+    else
+        search = ccall((:make_search, libsimdalign), Ptr{Void}, (Csize_t, Csize_t, Int64), shard_size, top_k, threshold)
+        @assert search != C_NULL "failed to make a search"
+    end
+
+    try
+        # check the query and the scoring against the checkpoint before any work
+        search_shard(search, submat, gap_open, gap_extend, seq′, seq_t[])
+
+        # skip references that have been searched
+        n_done = ccall((:search_n_done, libsimdalign), UInt64, (Ptr{Void},), search)
+        state = start(refs)
+        for _ in 1:n_done
+            done(refs, state) && break
+            _, state = next(refs, state)
+        end
+
+        # the sequences of a shard must be alive while aligning them
+        shard = []
+        while !done(refs, state)
+            empty!(shard)
+            while length(shard) < shard_size && !done(refs, state)
+                ref, state = next(refs, state)
+                push!(shard, seqof(ref))
+            end
+            search_shard(search, submat, gap_open, gap_extend, seq′, [seq_t(ref) for ref in shard])
+            if !isempty(checkpoint)
+                ret = ccall((:save_search, libsimdalign), Cint, (Ptr{Void}, Cstring), search, checkpoint)
+                @assert ret == 0 "failed to save a checkpoint: $checkpoint"
+            end
+        end
+
+        hits = Vector{hit_t}(ccall((:search_n_hits, libsimdalign), Csize_t, (Ptr{Void},), search))
+        ccall((:search_hits, libsimdalign), Cint, (Ptr{Void}, Ptr{hit_t}), search, hits)
+        # the search is complete; a rerun must not return these hits without searching
+        isempty(checkpoint) || rm(checkpoint, force=true)
+        return hits
+    finally
+        ccall((:free_search, libsimdalign), Void, (Ptr{Void},), search)
+    end
+end
+
 end # module
@@ -109,9 +109,121 @@ function test_reversed_seqs{score_t}(::Type{score_t})
     end
 end
 
+function test_both_strands{score_t}(::Type{score_t})
+    seq = dna"ACGTTA"
+    refs = [
+        dna"ACGTTA",
+        dna"TAACGT",
+        dna"TAACG",
+        dna"GGACGTTAG",
+        dna"AACCTGA"[2:6],
+        dna"",
+    ]
+
+    submat = make_submat(score_t)
+    model = AffineGapScoreModel(submat, gap_open_penalty=5, gap_extend_penalty=3)
+    alns = paralign_score_both(submat, model.gap_open_penalty, model.gap_extend_penalty, seq, refs)
+
+    for i in 1:length(refs)
+        ref = refs[i]
+        aln = alns[i]
+        fwd = score(pairalign(GlobalAlignment(), seq, ref, model))
+        rev = score(pairalign(GlobalAlignment(), reverse_complement(seq), ref, model))
+        @test score(aln) == max(fwd, rev)
+        @test aln.strand == (rev > fwd ? 1 : 0)
+    end
+end
+
+# references that are interrupted by throwing themselves after the first n
+immutable InterruptedRefs <: Exception
+    refs::Vector
+    n::Int
+end
+
+Base.start(refs::InterruptedRefs) = 1
+Base.done(refs::InterruptedRefs, i) = i > length(refs.refs)
+Base.next(refs::InterruptedRefs, i) = i > refs.n ? throw(refs) : (refs.refs[i], i + 1)
+
+function test_sharded_search{score_t}(::Type{score_t})
+    seq = dna"ACGT"
+    refs = [
+        dna"ACGT",
+        dna"ACGG",
+        dna"AACGT",
+        dna"CT",
+        dna"",
+        dna"ACGTT",
+        dna"ACG",
+        dna"AACCTGA",
+    ]
+
+    submat = make_submat(score_t)
+    alns = paralign_score(submat, 5, 3, seq, refs)
+    expected = sort([hit_t(i - 1, score(alns[i])) for i in 1:length(refs)], by=hit -> (-hit.score, hit.ref_id))
+
+    for shard_size in (1, 3, 100)
+        @test search_sharded(submat, 5, 3, seq, refs, shard_size=shard_size, top_k=0) == expected
+        @test search_sharded(submat, 5, 3, seq, refs, shard_size=shard_size, top_k=3) == expected[1:3]
+        @test search_sharded(submat, 5, 3, seq, refs, shard_size=shard_size, threshold=-8) == filter(hit -> hit.score >= -8, expected)
+    end
+
+    # resume from a checkpoint left by an interrupted search
+    checkpoint = tempname()
+    try
+        # two shards of two references are saved before the interruption
+        @test_throws InterruptedRefs search_sharded(submat, 5, 3, seq, InterruptedRefs(refs, 5), shard_size=2, top_k=3, checkpoint=checkpoint)
+        @test isfile(checkpoint)
+
+        # the checkpoint must match the search
+        @test_throws ErrorException search_sharded(submat, 5, 3, seq, refs, shard_size=2, top_k=10, checkpoint=checkpoint)
+        @test_throws ErrorException search_sharded(submat, 5, 3, dna"ACGA", refs, shard_size=2, top_k=3, checkpoint=checkpoint)
+        @test_throws ErrorException search_sharded(submat, 5, 4, seq, refs, shard_size=2, top_k=3, checkpoint=checkpoint)
+
+        # resuming skips the searched references: replacing them does not change the hits
+        refs′ = vcat([dna"" for _ in 1:4], refs[5:end])
+        @test search_sharded(submat, 5, 3, seq, refs′, shard_size=2, top_k=3, checkpoint=checkpoint) == expected[1:3]
+        @test !isfile(checkpoint)
+
+        # a complete search does not leave a stale checkpoint
+        @test search_sharded(submat, 5, 3, seq, refs′, shard_size=2, top_k=3, checkpoint=checkpoint) != expected[1:3]
+    finally
+        rm(checkpoint, force=true)
+    end
+end
+
+function test_edit_distance()
+    seq = dna"ACGT"
+    refs = [
+        dna"ACGT",
+        dna"ACGG",
+        dna"AACGT",
+        dna"TTACGTTT",
+        dna"CT",
+        dna"",
+        dna"AACCTGA"[2:5],
+    ]
+    @test map(score, paredit_distance(seq, refs)) == [0, 1, 1, 4, 2, 4, 1]
+    @test map(score, paredit_distance(seq, refs, mode=EDIT_SEMIGLOBAL)) == [0, 1, 0, 0, 2, 4, 1]
+    @test map(score, paredit_distance(seq, refs, mode=1)) == [0, 1, 0, 0, 2, 4, 1]
+
+    # longer than a machine word
+    seq = DNASequence(repeat("ACGT", 20))
+    refs = [
+        seq,
+        DNASequence(repeat("ACGT", 19)),
+        DNASequence(string("T", repeat("ACGT", 20))),
+        DNASequence(string("G", repeat("ACGT", 20), "CC")),
+    ]
+    @test map(score, paredit_distance(seq, refs)) == [0, 4, 1, 3]
+    @test map(score, paredit_distance(seq, refs, mode=EDIT_SEMIGLOBAL)) == [0, 4, 0, 0]
+end
+
 # run tests
 for score_t in (Int8, Int16, Int32)
     test_same_seqs(score_t)
     test_empty_seq(score_t)
     test_various_seqs(score_t)
+    test_both_strands(score_t)
+    test_sharded_search(score_t)
 end
+test_edit_distance()